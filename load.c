@@ -24,169 +24,245 @@
 
 #include <stdlib.h>
 #include <string.h>
-#include <err.h>
+#include <unistd.h>
+#include <errno.h>
 #include <gmp.h>
 
-#include <gawen/safe-call.h>
-#include <gawen/verbose.h>
-#include <gawen/common.h>
-#include <gawen/iobuf.h>
 #include <gawen/xatoi.h>
 
 #include "common.h"
 #include "load.h"
+#include "primg.h"
 
 #define MAX_ROW_SIZE 65536
 #define MAX_IMG_SIZE (4096 * 4096)
+#define READ_SIZE    4096
 
-static struct pbm_img *img;
+#define SOURCE_EOF   -1
+#define SOURCE_ERR   -2
 
-static ssize_t xiobuf_read(const iofile_t file, void *buf, size_t count)
+/* Input either comes from a memory buffer or from a file descriptor.
+   In the later case data is the internal read buffer. */
+struct source {
+  int fd; /* -1 for memory buffers */
+
+  const unsigned char *data;
+  size_t size;
+  size_t pos;
+
+  unsigned char rbuf[READ_SIZE];
+};
+
+static int source_getc(struct source *src)
 {
-  ssize_t n = iobuf_read(file, buf, count);
-  if(n < 0)
-    err(EXIT_FAILURE, "cannot read");
-  return n;
+  if(src->pos == src->size) {
+    ssize_t n;
+
+    if(src->fd < 0)
+      return SOURCE_EOF;
+
+    do
+      n = read(src->fd, src->rbuf, READ_SIZE);
+    while(n < 0 && errno == EINTR);
+
+    if(n < 0)
+      return SOURCE_ERR;
+    if(n == 0)
+      return SOURCE_EOF;
+
+    src->data = src->rbuf;
+    src->size = n;
+    src->pos  = 0;
+  }
+
+  return src->data[src->pos++];
 }
 
-static ssize_t xxiobuf_gets(const iofile_t file, char *buf, size_t count)
+/* Read a line without its trailing newline. */
+static int source_gets(struct source *src, char *buf, size_t count, size_t *len)
 {
-  ssize_t n = iobuf_gets(file, buf, count);
-  if(n <= 0) {
-    if(n < 0)
-      err(EXIT_FAILURE, "cannot read line");
-    else
-      errx(EXIT_FAILURE, "unexpected end of file");
+  size_t n = 0;
+  int c;
+
+  while((c = source_getc(src)) != '\n') {
+    if(c == SOURCE_ERR)
+      return PRIMG_ERR_IO;
+    if(c == SOURCE_EOF) {
+      if(n == 0)
+        return PRIMG_ERR_EOF;
+      break;
+    }
+
+    if(n == count - 1)
+      return PRIMG_ERR_HEADER;
+    buf[n++] = c;
   }
 
-  return n;
+  buf[n] = '\0';
+  *len   = n;
+
+  return PRIMG_OK;
 }
 
-static ssize_t until_no_comment(const iofile_t file, char *buf, size_t count)
+static int until_no_comment(struct source *src, char *buf, size_t count, size_t *len)
 {
-  ssize_t n;
+  int ret;
   do
-    n = xxiobuf_gets(file, buf, count);
-  while(buf[0] == '#');
+    ret = source_gets(src, buf, count, len);
+  while(ret == PRIMG_OK && buf[0] == '#');
 
-  return n;
+  return ret;
 }
 
-static struct pbm_img * load_pbm_p1(const iofile_t file, char *buf, size_t count)
+static int load_pbm_p1(struct pbm_img **result, struct source *src, char *buf, size_t count)
 {
-  int err, size;
-  unsigned int w, h;
-  ssize_t n;
+  struct pbm_img *img;
+  int err, c, ret;
+  unsigned int w, h, size;
+  size_t n;
   char *w_s, *h_s;
 
-  n = until_no_comment(file, buf, count);
-  strip_gets_newline(buf, n);
+  ret = until_no_comment(src, buf, count, &n);
+  if(ret != PRIMG_OK)
+    return ret;
 
   w_s = buf;
   h_s = memchr(buf, ' ', n);
 
-
   if(!h_s)
-    errx(EXIT_FAILURE, "invalid pbm header");
+    return PRIMG_ERR_HEADER;
 
   *h_s = '\0';
   h_s++;
 
   w = xatou(w_s, &err);
-  if(err != XATOI_SUCCESS)
-    errx(EXIT_FAILURE, "invalid pbm width");
+  if(err != XATOI_SUCCESS || w == 0)
+    return PRIMG_ERR_WIDTH;
   h = xatou(h_s, &err);
-  if(err != XATOI_SUCCESS)
-    errx(EXIT_FAILURE, "invalid pbm height");
+  if(err != XATOI_SUCCESS || h == 0)
+    return PRIMG_ERR_HEIGHT;
 
+  if(h > MAX_IMG_SIZE / w)
+    return PRIMG_ERR_TOO_LARGE;
   size = w * h;
-  if(size > MAX_IMG_SIZE)
-    errx(EXIT_FAILURE, "image too large");
 
-  img = xmalloc(sizeof(struct pbm_img));
+  img = malloc(sizeof(struct pbm_img));
+  if(!img)
+    return PRIMG_ERR_NOMEM;
 
-  img->width  = w;
-  img->height = h;
+  img->width    = w;
+  img->height   = h;
+  img->warnings = 0;
+  img->order    = PRIMG_ORDER_ROW;
 
   /* We may count the leading zeros here and alloc a smaller GMP integer,
      but I'm not sure that would be worth the try (memory wise). */
   mpz_init2(img->number, size);
 
-  while((n = xiobuf_read(file, buf, count))) {
-    const char *s = buf;
-
-    while(n--) {
-      if(size == 0) {
-        warnx("garbage after raster data");
-        goto EXIT;
-      }
-
-      switch(*s++) {
-      case ' ':
-      case '\n':
-        break;
-      case '0':
-        /* FIXME: I'm not sure we need this.
-           What if GMP integer are initialized
-           to zero? */
-        mpz_clrbit(img->number, --size);
-        break;
-      case '1':
-        mpz_setbit(img->number, --size);
-        break;
-      }
+  while((c = source_getc(src)) >= 0) {
+    if(size == 0) {
+      if(c != ' ' && c != '\n')
+        img->warnings |= PRIMG_WARN_GARBAGE;
+      continue;
+    }
+
+    switch(c) {
+    case ' ':
+    case '\n':
+      break;
+    case '0':
+      /* FIXME: I'm not sure we need this.
+         What if GMP integer are initialized
+         to zero? */
+      mpz_clrbit(img->number, --size);
+      break;
+    case '1':
+      mpz_setbit(img->number, --size);
+      break;
     }
   }
 
+  if(c == SOURCE_ERR) {
+    primg_free(img);
+    return PRIMG_ERR_IO;
+  }
+
   if(size)
-    warnx("incomplete raster data");
+    img->warnings |= PRIMG_WARN_INCOMPLETE;
 
-EXIT:
-  verbose("PBM ASCII image loaded (%dx%d)\n", w, h);
-  return img;
+  *result = img;
+  return PRIMG_OK;
 }
 
-static struct pbm_img * load_pbm_p4(const iofile_t file, char *buf, size_t count)
+static int load_pbm_p4(struct pbm_img **result, struct source *src, char *buf, size_t count)
 {
-  UNUSED(file);
+  UNUSED(result);
+  UNUSED(src);
   UNUSED(buf);
   UNUSED(count);
 
   /* TODO: please implement this :(
            it's not that hard. */
-  errx(EXIT_FAILURE, "not implemented yet :(");
-  return NULL;
+  return PRIMG_ERR_NOT_IMPLEMENTED;
 }
 
-struct pbm_img * load_pbm(const char *path)
+static int load_pbm(struct pbm_img **img, struct source *src)
 {
   char row[MAX_ROW_SIZE];
-  iofile_t img;
-  ssize_t n;
-
-  if(path)
-    img = iobuf_open(path, O_RDONLY, 0);
-  else
-    img = iobuf_dopen(STDIN_FILENO);
+  size_t n;
+  int ret;
 
   if(!img)
-    err(EXIT_FAILURE, "cannot open pbm");
+    return PRIMG_ERR_INVALID;
 
   /* check for magic */
-  n = until_no_comment(img, row, MAX_ROW_SIZE);
-  strip_gets_newline(row, n);
+  ret = until_no_comment(src, row, MAX_ROW_SIZE, &n);
+  if(ret != PRIMG_OK)
+    return ret;
 
   if(!strcmp(row, "P1"))
-    return load_pbm_p1(img, row, MAX_ROW_SIZE);
+    return load_pbm_p1(img, src, row, MAX_ROW_SIZE);
   else if(!strcmp(row, "P4"))
-    return load_pbm_p4(img, row, MAX_ROW_SIZE);
+    return load_pbm_p4(img, src, row, MAX_ROW_SIZE);
   else
-    errx(EXIT_FAILURE, "invalid pbm magic");
-  return 0; /* avoid warning */
+    return PRIMG_ERR_MAGIC;
+}
+
+int primg_load_fd(struct pbm_img **img, int fd)
+{
+  struct source src;
+
+  if(fd < 0)
+    return PRIMG_ERR_INVALID;
+
+  src.fd   = fd;
+  src.data = src.rbuf;
+  src.size = 0;
+  src.pos  = 0;
+
+  return load_pbm(img, &src);
 }
 
-void free_pbm(struct pbm_img *img)
+int primg_load_mem(struct pbm_img **img, const void *buf, size_t size)
 {
+  struct source src;
+
+  if(!buf && size)
+    return PRIMG_ERR_INVALID;
+
+  src.fd   = -1;
+  src.data = buf;
+  src.size = size;
+  src.pos  = 0;
+
+  return load_pbm(img, &src);
+}
+
+void primg_free(struct pbm_img *img)
+{
+  if(!img)
+    return;
+
   mpz_clear(img->number);
   free(img);
 }
@@ -26,14 +26,15 @@
 
 #include <gmp.h>
 
+#include "primg.h"
+
 struct pbm_img {
   unsigned int width;
   unsigned int height;
+  unsigned int warnings; /* primg_warning flags */
+  int          order;    /* primg_order used by the last primify */
 
   mpz_t        number; /* integer representation of the image */
 };
 
-struct pbm_img * load_pbm(const char *path);
-void free_pbm(struct pbm_img *img);
-
 #endif /* _LOAD_H_ */
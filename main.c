@@ -26,6 +26,8 @@
 #include <stdlib.h>
 #include <getopt.h>
 #include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
 #include <err.h>
 #include <ftw.h>
 
@@ -34,10 +36,8 @@
 #include <gawen/help.h>
 
 #include "version.h"
-#include "output.h"
-#include "prime.h"
+#include "primg.h"
 #include "main.h"
-#include "load.h"
 
 static void print_help(const char *name)
 {
@@ -49,16 +49,81 @@ static void print_help(const char *name)
     { 0,   "commit",  "Display commit information" },
 #endif /* COMMIT */
     { 'f', "format",  "Select output format (?/list for list)" },
+    { 'o', "order",   "Comma separated pixel orders to race (?/list for list)" },
+    { 'b', "best",    "Keep the order with the fewest modified pixels" },
+    { 't', "tune",    "Tune the prime search for this CPU into a profile file" },
+    { 'p', "profile", "Load a tuning profile (also " PROFILE_ENV ")" },
     { 0, NULL, NULL }
   };
 
   help(name, "[options] [pbm-file]", messages);
 }
 
+static void load_profile(struct primg_options *opts, const char *path)
+{
+  struct primg_profile *profile;
+  int ret = primg_profile_load(&profile, path);
+
+  if(ret == PRIMG_ERR_NO_PROFILE) {
+    /* keep the default parameters on CPUs not tuned yet */
+    warnx("%s: %s", path, primg_strerror(ret));
+    return;
+  }
+  else if(ret == PRIMG_ERR_IO)
+    err(EXIT_FAILURE, "cannot open profile");
+  else if(ret != PRIMG_OK)
+    errx(EXIT_FAILURE, "%s: %s", path, primg_strerror(ret));
+
+  opts->profile = profile;
+}
+
+static void list_orders(void)
+{
+  int i;
+
+  for(i = 0 ; i < PRIMG_ORDER_MAX ; i++)
+    printf("%s\n", primg_order_name(i));
+  printf("all\n");
+}
+
+static unsigned int parse_orders(const char *list)
+{
+  char name[32];
+  unsigned int orders = 0;
+
+  if(!strcmp(list, "all"))
+    return PRIMG_ORDER_ALL;
+
+  while(*list) {
+    const char *end = strchr(list, ',');
+    size_t len = end ? (size_t)(end - list) : strlen(list);
+    int order;
+
+    if(len >= sizeof(name))
+      errx(EXIT_FAILURE, "invalid order");
+
+    memcpy(name, list, len);
+    name[len] = '\0';
+
+    order = primg_order_parse(name);
+    if(order < 0)
+      errx(EXIT_FAILURE, "unknown order '%s'", name);
+    orders |= 1 << order;
+
+    list += len;
+    if(*list)
+      list++;
+  }
+
+  return orders;
+}
+
 int main(int argc, char *argv[])
 {
-  const char *prog_name, *img_path;
+  const char *prog_name, *img_path, *profile_path = NULL;
+  struct primg_options primg_opts;
   struct pbm_img *img;
+  int fd, ret;
   int exit_status = EXIT_FAILURE;
   /* int flags       = 0; */
 
@@ -70,6 +135,10 @@ int main(int argc, char *argv[])
     { "help", no_argument, NULL, 'h' },
     { "version", no_argument, NULL, 'V' },
     { "verbose", no_argument, NULL, 'v' },
+    { "order", required_argument, NULL, 'o' },
+    { "best", no_argument, NULL, 'b' },
+    { "tune", required_argument, NULL, 't' },
+    { "profile", required_argument, NULL, 'p' },
 #ifdef COMMIT
     { "commit", no_argument, NULL, OPT_COMMIT },
 #endif /* COMMIT */
@@ -81,8 +150,10 @@ int main(int argc, char *argv[])
 #endif
   prog_name = basename(argv[0]);
 
+  primg_options_init(&primg_opts);
+
   while(1) {
-    int c = getopt_long(argc, argv, "hVvc", opts, NULL);
+    int c = getopt_long(argc, argv, "hVvco:bt:p:", opts, NULL);
 
     if(c == -1)
       break;
@@ -91,6 +162,29 @@ int main(int argc, char *argv[])
     case 'v':
       set_verbose(1);
       break;
+    case 'o':
+      if(!strcmp(optarg, "?") || !strcmp(optarg, "list")) {
+        list_orders();
+        exit_status = EXIT_SUCCESS;
+        goto EXIT;
+      }
+      primg_opts.orders = parse_orders(optarg);
+      break;
+    case 'b':
+      primg_opts.select = PRIMG_SELECT_BEST;
+      break;
+    case 't':
+      verbose("tuning, this may take a while...\n");
+      ret = primg_tune(optarg, &primg_opts, NULL);
+      if(ret == PRIMG_ERR_IO)
+        err(EXIT_FAILURE, "cannot write profile");
+      else if(ret != PRIMG_OK)
+        errx(EXIT_FAILURE, "%s: %s", optarg, primg_strerror(ret));
+      exit_status = EXIT_SUCCESS;
+      goto EXIT;
+    case 'p':
+      profile_path = optarg;
+      break;
     case 'V':
       version();
       exit_status = EXIT_SUCCESS;
@@ -120,10 +214,48 @@ int main(int argc, char *argv[])
     goto EXIT;
   }
 
-  img = load_pbm(img_path);
-  primify(img);
-  output(img);
-  free_pbm((void *)img);
+  if(!profile_path)
+    profile_path = getenv(PROFILE_ENV);
+  if(profile_path)
+    load_profile(&primg_opts, profile_path);
+
+  if(img_path) {
+    fd = open(img_path, O_RDONLY);
+    if(fd < 0)
+      err(EXIT_FAILURE, "cannot open pbm");
+  }
+  else
+    fd = STDIN_FILENO;
+
+  ret = primg_load_fd(&img, fd);
+  if(ret == PRIMG_ERR_IO)
+    err(EXIT_FAILURE, "cannot read");
+  else if(ret != PRIMG_OK)
+    errx(EXIT_FAILURE, "%s", primg_strerror(ret));
+
+  if(primg_warnings(img) & PRIMG_WARN_GARBAGE)
+    warnx("garbage after raster data");
+  if(primg_warnings(img) & PRIMG_WARN_INCOMPLETE)
+    warnx("incomplete raster data");
+  verbose("PBM ASCII image loaded (%dx%d)\n", primg_width(img), primg_height(img));
+
+  if(img_path)
+    close(fd);
+
+  verbose("searching next prime... ");
+  ret = primg_primify(img, &primg_opts, NULL);
+  if(ret != PRIMG_OK)
+    errx(EXIT_FAILURE, "%s", primg_strerror(ret));
+  verbose("found :) (%s order)\n", primg_order_name(primg_order(img)));
+
+  ret = primg_output_fd(img, STDOUT_FILENO);
+  if(ret == PRIMG_ERR_IO)
+    err(EXIT_FAILURE, "cannot write");
+  else if(ret != PRIMG_OK)
+    errx(EXIT_FAILURE, "%s", primg_strerror(ret));
+
+  primg_free(img);
+  primg_profile_free((struct primg_profile *)primg_opts.profile);
 
   exit_status = EXIT_SUCCESS;
 EXIT:
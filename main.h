@@ -25,6 +25,8 @@
 #ifndef _MAIN_H_
 #define _MAIN_H_
 
+#define PROFILE_ENV "PRIMG_PROFILE"
+
 #if 0
 /* empty for now */
 enum opt_flags {
@@ -0,0 +1,108 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <string.h>
+#include <gmp.h>
+
+#include "common.h"
+#include "order.h"
+#include "load.h"
+#include "primg.h"
+
+static const char *names[] = {
+  [PRIMG_ORDER_ROW]        = "row",
+  [PRIMG_ORDER_COLUMN]     = "column",
+  [PRIMG_ORDER_SERPENTINE] = "serpentine",
+  [PRIMG_ORDER_BOTTOM_UP]  = "bottom-up"
+};
+
+const char * primg_order_name(int order)
+{
+  if(order < 0 || order >= PRIMG_ORDER_MAX)
+    return NULL;
+  return names[order];
+}
+
+int primg_order_parse(const char *name)
+{
+  unsigned int i;
+
+  for(i = 0 ; i < sizeof_array(names) ; i++)
+    if(!strcmp(name, names[i]))
+      return i;
+  return -1;
+}
+
+/* Position in the order of the pixel (r, c). */
+static unsigned int order_index(int order, unsigned int w, unsigned int h,
+                                unsigned int r, unsigned int c)
+{
+  switch(order) {
+  case PRIMG_ORDER_COLUMN:
+    return c * h + r;
+  case PRIMG_ORDER_SERPENTINE:
+    return r * w + (r & 1 ? w - 1 - c : c);
+  case PRIMG_ORDER_BOTTOM_UP:
+    return (h - 1 - r) * w + c;
+  case PRIMG_ORDER_ROW:
+  default:
+    return r * w + c;
+  }
+}
+
+void order_from_image(mpz_t out, const struct pbm_img *img, int order)
+{
+  unsigned int w = img->width, h = img->height;
+  unsigned int size = w * h;
+  unsigned int r, c;
+
+  if(order == PRIMG_ORDER_ROW) {
+    mpz_set(out, img->number);
+    return;
+  }
+
+  mpz_set_ui(out, 0);
+  for(r = 0 ; r < h ; r++)
+    for(c = 0 ; c < w ; c++)
+      if(mpz_tstbit(img->number, size - 1 - (r * w + c)))
+        mpz_setbit(out, size - 1 - order_index(order, w, h, r, c));
+}
+
+void order_to_image(mpz_t out, const mpz_t in, const struct pbm_img *img, int order)
+{
+  unsigned int w = img->width, h = img->height;
+  unsigned int size = w * h;
+  unsigned int r, c;
+
+  if(order == PRIMG_ORDER_ROW) {
+    mpz_set(out, in);
+    return;
+  }
+
+  mpz_set_ui(out, 0);
+  for(r = 0 ; r < h ; r++)
+    for(c = 0 ; c < w ; c++)
+      if(mpz_tstbit(in, size - 1 - order_index(order, w, h, r, c)))
+        mpz_setbit(out, size - 1 - (r * w + c));
+}
@@ -22,13 +22,16 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifndef _OUTPUT_H_
-#define _OUTPUT_H_
+#ifndef _ORDER_H_
+#define _ORDER_H_
 
 #include <gmp.h>
 
 #include "load.h"
 
-void output(const struct pbm_img *img);
+/* Convert the row-major integer of an image to the integer
+   read in another order and back. */
+void order_from_image(mpz_t out, const struct pbm_img *img, int order);
+void order_to_image(mpz_t out, const mpz_t in, const struct pbm_img *img, int order);
 
-#endif /* _OUTPUT_H_ */
+#endif /* _ORDER_H_ */
@@ -25,57 +25,195 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <errno.h>
 #include <gmp.h>
-#include <err.h>
-
-#include <gawen/safe-call.h>
-#include <gawen/verbose.h>
-#include <gawen/iobuf.h>
 
 #include "version.h"
 #include "load.h"
+#include "primg.h"
 
 #define MAX_GEOM_STRING 32
+#define WRITE_SIZE      4096
 
-void output(const struct pbm_img *img)
-{
+#define HEADER "P1\n"                           \
+  "# CREATOR: " PACKAGE_VERSION "\n"            \
+  "# URL    : " WEBSITE "\n"                    \
+  "# ORDER  : "
+
+/* Output either goes to a caller-provided memory buffer or to a file
+   descriptor. In the later case buf is the internal write buffer. */
+struct sink {
+  int fd; /* -1 for memory buffers */
+
+  char  *buf;
+  size_t size;
+  size_t pos;
+
+  char wbuf[WRITE_SIZE];
+};
+
+struct geometry {
+  unsigned int w, h;
+  unsigned int zeros;      /* leading zeros */
+  unsigned int prime_size; /* size of the prime in bits */
   char geom_string[MAX_GEOM_STRING];
-  int w, h, zeros, i, j = 0;
-  int prime_size = mpz_sizeinbase(img->number, 2);
-  iofile_t out = iobuf_dopen(STDOUT_FILENO);
+};
 
-  w = img->width;
-  h = img->height;
+static void compute_geometry(const struct pbm_img *img, struct geometry *geom)
+{
+  unsigned int prime_size = mpz_sizeinbase(img->number, 2);
+  unsigned int w = img->width, h = img->height;
 
   if(w * h < prime_size) {
-    int missing = prime_size - w * h;
-    h     += 1 + ((missing - 1) / w); /* ceil(missing / w ) */
-    zeros  = w - missing % w;
-
-    verbose("prime larger than image, height %d->%d\n", img->height, h);
+    unsigned int missing = prime_size - w * h;
+    h += 1 + ((missing - 1) / w); /* ceil(missing / w ) */
   }
-  else
-    zeros = w * h - prime_size;
 
-  verbose("leading zeros %d\n", zeros);
+  geom->zeros      = w * h - prime_size;
+  geom->w          = w;
+  geom->h          = h;
+  geom->prime_size = prime_size;
 
-  iobuf_puts(out, "P1\n");
-  iobuf_puts(out, "# CREATOR: " PACKAGE_VERSION "\n");
-  iobuf_puts(out, "# URL    : " WEBSITE "\n");
+  snprintf(geom->geom_string, MAX_GEOM_STRING, "%u %u", w, h);
+}
+
+static int sink_flush(struct sink *out)
+{
+  size_t done = 0;
+
+  if(out->fd < 0)
+    return out->pos == out->size ? PRIMG_ERR_BUFFER : PRIMG_OK;
+
+  while(done < out->pos) {
+    ssize_t n = write(out->fd, out->buf + done, out->pos - done);
+    if(n < 0) {
+      if(errno == EINTR)
+        continue;
+      return PRIMG_ERR_IO;
+    }
+    done += n;
+  }
 
-  snprintf(geom_string, MAX_GEOM_STRING, "%d %d", w, h);
-  iobuf_puts(out, geom_string);
+  out->pos = 0;
+  return PRIMG_OK;
+}
 
-  for(i = zeros; i ; i--) {
-    if(j++ % w == 0)
-      iobuf_putc('\n', out);
-    iobuf_putc('0', out);
+static int sink_putc(struct sink *out, char c)
+{
+  if(out->pos == out->size) {
+    int ret = sink_flush(out);
+    if(ret != PRIMG_OK)
+      return ret;
   }
 
-  for(i = prime_size - 1; i >= 0 ; i--) {
-    if(j++ % w == 0)
-      iobuf_putc('\n', out);
-    iobuf_putc(mpz_tstbit(img->number, i) ? '1' : '0', out);
+  out->buf[out->pos++] = c;
+  return PRIMG_OK;
+}
+
+static int sink_puts(struct sink *out, const char *s)
+{
+  int ret = PRIMG_OK;
+
+  while(*s && ret == PRIMG_OK)
+    ret = sink_putc(out, *s++);
+  return ret;
+}
+
+static int put_pixel(struct sink *out, const struct geometry *geom,
+                     unsigned int *j, char pixel)
+{
+  if((*j)++ % geom->w == 0) {
+    int ret = sink_putc(out, '\n');
+    if(ret != PRIMG_OK)
+      return ret;
   }
-  iobuf_close(out);
+
+  return sink_putc(out, pixel);
+}
+
+static int output(const struct pbm_img *img, struct sink *out)
+{
+  struct geometry geom;
+  unsigned int i, j = 0;
+  int ret;
+
+  compute_geometry(img, &geom);
+
+  ret = sink_puts(out, HEADER);
+  if(ret != PRIMG_OK)
+    return ret;
+  ret = sink_puts(out, primg_order_name(img->order));
+  if(ret != PRIMG_OK)
+    return ret;
+  ret = sink_putc(out, '\n');
+  if(ret != PRIMG_OK)
+    return ret;
+  ret = sink_puts(out, geom.geom_string);
+  if(ret != PRIMG_OK)
+    return ret;
+
+  for(i = geom.zeros; i && ret == PRIMG_OK ; i--)
+    ret = put_pixel(out, &geom, &j, '0');
+
+  for(i = geom.prime_size; i && ret == PRIMG_OK ; i--)
+    ret = put_pixel(out, &geom, &j, mpz_tstbit(img->number, i - 1) ? '1' : '0');
+
+  if(ret != PRIMG_OK)
+    return ret;
+
+  if(out->fd >= 0)
+    return sink_flush(out);
+  return PRIMG_OK;
+}
+
+size_t primg_output_size(const struct pbm_img *img)
+{
+  struct geometry geom;
+
+  compute_geometry(img, &geom);
+
+  /* each row starts with a newline */
+  return (sizeof(HEADER) - 1) + strlen(primg_order_name(img->order)) + 1 +
+    strlen(geom.geom_string) +
+    (size_t)(geom.w + 1) * geom.h;
+}
+
+int primg_output_mem(const struct pbm_img *img, void *buf, size_t size, size_t *written)
+{
+  struct sink out;
+  int ret;
+
+  if(!img || (!buf && size))
+    return PRIMG_ERR_INVALID;
+
+  /* Check the size first so that we do not fail midway. */
+  if(size < primg_output_size(img))
+    return PRIMG_ERR_BUFFER;
+
+  out.fd   = -1;
+  out.buf  = buf;
+  out.size = size;
+  out.pos  = 0;
+
+  ret = output(img, &out);
+  if(written)
+    *written = out.pos;
+
+  return ret;
+}
+
+int primg_output_fd(const struct pbm_img *img, int fd)
+{
+  struct sink out;
+
+  if(!img || fd < 0)
+    return PRIMG_ERR_INVALID;
+
+  out.fd   = fd;
+  out.buf  = out.wbuf;
+  out.size = WRITE_SIZE;
+  out.pos  = 0;
+
+  return output(img, &out);
 }
@@ -23,23 +23,283 @@
  */
 
 #include <stdlib.h>
-#include <string.h>
-#include <assert.h>
+#include <pthread.h>
 #include <gmp.h>
 
-#include <gawen/safe-call.h>
-#include <gawen/verbose.h>
-
-#include "output.h"
+#include "profile.h"
+#include "sieve.h"
+#include "order.h"
 #include "load.h"
-#include "main.h"
+#include "primg.h"
+
+struct race {
+  const struct pbm_img       *img;
+  const struct primg_options *opts;
+  const struct primg_cancel  *cancel; /* caller token, may be NULL */
+  struct primg_cancel         done;   /* set once a winner is known */
+  int                         winner; /* first order found or -1 */
+  unsigned int                sieve_bound;
+  unsigned int                window;
+};
+
+struct runner {
+  pthread_t    thread;
+  int          spawned;
+  struct race *race;
+  int          order;
+  int          status;
+  mpz_t        result; /* row-major integer of the image */
+};
+
+static int is_cancelled(const struct race *race)
+{
+  if(race->cancel && primg_is_cancelled(race->cancel))
+    return 1;
+  return primg_is_cancelled(&race->done);
+}
+
+static int next_prime_sieve(mpz_t candidate, const struct race *race,
+                            struct sieve *sieve)
+{
+  unsigned int i;
+  mpz_t base;
 
-void primify(struct pbm_img *img)
+  mpz_init_set(base, candidate);
+
+  while(1) {
+    sieve_window(sieve, base, sieve->window);
+
+    for(i = 0 ; i < sieve->window ; i++) {
+      if(sieve->marks[i])
+        continue;
+
+      if(is_cancelled(race)) {
+        mpz_clear(base);
+        return PRIMG_ERR_CANCELLED;
+      }
+
+      mpz_add_ui(candidate, base, 2 * (unsigned long)i);
+      if(mpz_probab_prime_p(candidate, race->opts->reps)) {
+        mpz_clear(base);
+        return PRIMG_OK;
+      }
+    }
+
+    mpz_add_ui(base, base, 2 * (unsigned long)sieve->window);
+  }
+}
+
+/* Find the nearest prime above p.
+   We might miss some in between,
+   although with a very low probability. */
+static int next_prime(mpz_t candidate, const struct race *race,
+                      struct sieve *sieve)
 {
-  /* Find the nearest prime above p.
-     We might miss some in between,
-     although with a very low probability. */
-  verbose("searching next prime... ");
-  mpz_nextprime(img->number, img->number);
-  verbose("found :)\n");
+  if(mpz_cmp_ui(candidate, 2) < 0) {
+    mpz_set_ui(candidate, 2);
+    return PRIMG_OK;
+  }
+
+  mpz_add_ui(candidate, candidate, 1);
+  mpz_setbit(candidate, 0);
+
+  /* the sieve would discard the small primes themselves */
+  if(sieve && mpz_cmp_ui(candidate, sieve->bound) > 0)
+    return next_prime_sieve(candidate, race, sieve);
+
+  while(!mpz_probab_prime_p(candidate, race->opts->reps)) {
+    if(is_cancelled(race))
+      return PRIMG_ERR_CANCELLED;
+
+    mpz_add_ui(candidate, candidate, 2);
+  }
+
+  return PRIMG_OK;
+}
+
+static void * run(void *arg)
+{
+  struct runner *runner = arg;
+  struct race   *race   = runner->race;
+  const struct pbm_img *img = race->img;
+  struct sieve sieve, *psieve = NULL;
+  mpz_t candidate;
+
+  if(race->sieve_bound) {
+    runner->status = sieve_init(&sieve, race->sieve_bound, race->window);
+    if(runner->status != PRIMG_OK)
+      return NULL;
+    psieve = &sieve;
+  }
+
+  mpz_init(candidate);
+  order_from_image(candidate, img, runner->order);
+
+  runner->status = next_prime(candidate, race, psieve);
+  if(runner->status != PRIMG_OK)
+    goto EXIT;
+
+  /* Only the row-major order may grow the image. */
+  if(runner->order != PRIMG_ORDER_ROW &&
+     mpz_sizeinbase(candidate, 2) > img->width * img->height) {
+    runner->status = PRIMG_ERR_NO_PRIME;
+    goto EXIT;
+  }
+
+  order_to_image(runner->result, candidate, img, runner->order);
+
+  if(race->opts->select == PRIMG_SELECT_FIRST) {
+    int none = -1;
+    if(__atomic_compare_exchange_n(&race->winner, &none, runner->order, 0,
+                                   __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      primg_cancel(&race->done);
+  }
+
+EXIT:
+  if(psieve)
+    sieve_free(psieve);
+  mpz_clear(candidate);
+  return NULL;
+}
+
+/* The row-major prime may be larger than the image, add the missing rows
+   on top so that the handle and a later search see the whole integer. */
+static void grow(struct pbm_img *img)
+{
+  unsigned long prime_size = mpz_sizeinbase(img->number, 2);
+  unsigned long size = (unsigned long)img->width * img->height;
+
+  if(prime_size > size)
+    img->height += 1 + (prime_size - size - 1) / img->width;
+}
+
+/* Number of pixels modified by the runner. */
+static unsigned long distortion(const struct runner *runner, const struct pbm_img *img)
+{
+  unsigned long n;
+  mpz_t diff;
+
+  mpz_init(diff);
+  mpz_xor(diff, runner->result, img->number);
+  n = mpz_popcount(diff);
+  mpz_clear(diff);
+
+  return n;
+}
+
+static int select_best(struct runner *runners, int n, const struct pbm_img *img)
+{
+  unsigned long best_distortion = 0;
+  int i, best = -1;
+
+  for(i = 0 ; i < n ; i++) {
+    unsigned long d;
+
+    if(runners[i].status != PRIMG_OK)
+      continue;
+
+    d = distortion(&runners[i], img);
+    if(best < 0 || d < best_distortion) {
+      best = i;
+      best_distortion = d;
+    }
+  }
+
+  return best;
+}
+
+int primg_primify(struct pbm_img *img,
+                  const struct primg_options *opts,
+                  const struct primg_cancel *cancel)
+{
+  struct primg_options defaults;
+  struct runner runners[PRIMG_ORDER_MAX];
+  struct race race;
+  int i, n = 0, best = -1, ret = PRIMG_ERR_NO_PRIME;
+
+  if(!img)
+    return PRIMG_ERR_INVALID;
+
+  if(!opts) {
+    primg_options_init(&defaults);
+    opts = &defaults;
+  }
+
+  if(!(opts->orders & PRIMG_ORDER_ALL))
+    return PRIMG_ERR_INVALID;
+
+  race.img    = img;
+  race.opts   = opts;
+  race.cancel = cancel;
+  race.winner = -1;
+  primg_cancel_init(&race.done);
+
+  if(opts->profile)
+    profile_params(opts->profile, mpz_sizeinbase(img->number, 2),
+                   &race.sieve_bound, &race.window);
+  else {
+    race.sieve_bound = opts->sieve_bound;
+    race.window      = opts->window;
+  }
+
+  for(i = 0 ; i < PRIMG_ORDER_MAX ; i++) {
+    if(!(opts->orders & (1 << i)))
+      continue;
+
+    runners[n].race   = &race;
+    runners[n].order  = i;
+    runners[n].status = PRIMG_ERR_CANCELLED;
+    mpz_init(runners[n].result);
+    n++;
+  }
+
+  /* A single order is searched in the calling thread. If we cannot
+     spawn a thread we also fall back to the calling thread. */
+  if(n == 1)
+    run(&runners[0]);
+  else {
+    for(i = 0 ; i < n ; i++)
+      runners[i].spawned = !pthread_create(&runners[i].thread, NULL,
+                                           run, &runners[i]);
+    for(i = 0 ; i < n ; i++) {
+      if(runners[i].spawned)
+        pthread_join(runners[i].thread, NULL);
+      else
+        run(&runners[i]);
+    }
+  }
+
+  /* We work on copies so that the image
+     stays untouched on cancellation. We
+     do not keep a partial race either. */
+  if(cancel && primg_is_cancelled(cancel))
+    ret = PRIMG_ERR_CANCELLED;
+  else {
+    if(opts->select == PRIMG_SELECT_FIRST) {
+      for(i = 0 ; i < n ; i++)
+        if(runners[i].order == race.winner)
+          best = i;
+    }
+    else
+      best = select_best(runners, n, img);
+
+    if(best >= 0) {
+      mpz_swap(img->number, runners[best].result);
+      img->order = runners[best].order;
+      grow(img);
+      ret = PRIMG_OK;
+    }
+    else {
+      /* report errors such as a failed sieve allocation */
+      for(i = 0 ; i < n ; i++)
+        if(runners[i].status != PRIMG_ERR_NO_PRIME &&
+           runners[i].status != PRIMG_ERR_CANCELLED)
+          ret = runners[i].status;
+    }
+  }
+
+  for(i = 0 ; i < n ; i++)
+    mpz_clear(runners[i].result);
+
+  return ret;
 }
@@ -0,0 +1,107 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+
+#include "common.h"
+#include "load.h"
+#include "primg.h"
+
+#define DEFAULT_REPS        25
+#define DEFAULT_SIEVE_BOUND 1024
+#define DEFAULT_WINDOW      4096
+
+static const char *errors[] = {
+  [PRIMG_OK]                  = "success",
+  [PRIMG_ERR_IO]              = "input/output error",
+  [PRIMG_ERR_EOF]             = "unexpected end of file",
+  [PRIMG_ERR_MAGIC]           = "invalid pbm magic",
+  [PRIMG_ERR_HEADER]          = "invalid pbm header",
+  [PRIMG_ERR_WIDTH]           = "invalid pbm width",
+  [PRIMG_ERR_HEIGHT]          = "invalid pbm height",
+  [PRIMG_ERR_TOO_LARGE]       = "image too large",
+  [PRIMG_ERR_NOT_IMPLEMENTED] = "not implemented yet :(",
+  [PRIMG_ERR_NOMEM]           = "out of memory",
+  [PRIMG_ERR_CANCELLED]       = "operation cancelled",
+  [PRIMG_ERR_BUFFER]          = "output buffer too small",
+  [PRIMG_ERR_INVALID]         = "invalid argument",
+  [PRIMG_ERR_NO_PRIME]        = "no prime fits in the image",
+  [PRIMG_ERR_PROFILE]         = "invalid tuning profile",
+  [PRIMG_ERR_NO_PROFILE]      = "no tuning profile for this cpu"
+};
+
+const char * primg_strerror(int error)
+{
+  if(error < 0 || (size_t)error >= sizeof_array(errors))
+    return "unknown error";
+  return errors[error];
+}
+
+void primg_options_init(struct primg_options *opts)
+{
+  opts->reps   = DEFAULT_REPS;
+  opts->orders = 1 << PRIMG_ORDER_ROW;
+  opts->select = PRIMG_SELECT_FIRST;
+
+  opts->sieve_bound = DEFAULT_SIEVE_BOUND;
+  opts->window      = DEFAULT_WINDOW;
+  opts->profile     = NULL;
+}
+
+/* The token is written and read from different threads. We stick to C99
+   for the rest of the code, so rely on the GCC/Clang atomic builtins. */
+void primg_cancel_init(struct primg_cancel *cancel)
+{
+  __atomic_store_n(&cancel->cancelled, 0, __ATOMIC_RELAXED);
+}
+
+void primg_cancel(struct primg_cancel *cancel)
+{
+  __atomic_store_n(&cancel->cancelled, 1, __ATOMIC_RELAXED);
+}
+
+int primg_is_cancelled(const struct primg_cancel *cancel)
+{
+  return __atomic_load_n(&cancel->cancelled, __ATOMIC_RELAXED);
+}
+
+unsigned int primg_width(const struct pbm_img *img)
+{
+  return img->width;
+}
+
+unsigned int primg_height(const struct pbm_img *img)
+{
+  return img->height;
+}
+
+unsigned int primg_warnings(const struct pbm_img *img)
+{
+  return img->warnings;
+}
+
+int primg_order(const struct pbm_img *img)
+{
+  return img->order;
+}
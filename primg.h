@@ -0,0 +1,160 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PRIMG_H_
+#define _PRIMG_H_
+
+#include <stddef.h>
+
+/* Public API of libprimg.
+
+   Each image handle is independent and the library keeps no global
+   state, so distinct handles may be processed concurrently from
+   different threads. A single handle must not be used by two threads
+   at the same time. Functions that can fail return PRIMG_OK (zero) on
+   success and one of the primg_error codes otherwise. */
+
+enum primg_error {
+  PRIMG_OK = 0,
+  PRIMG_ERR_IO,              /* read or write failed (see errno) */
+  PRIMG_ERR_EOF,             /* unexpected end of file */
+  PRIMG_ERR_MAGIC,           /* invalid pbm magic */
+  PRIMG_ERR_HEADER,          /* invalid pbm header */
+  PRIMG_ERR_WIDTH,           /* invalid pbm width */
+  PRIMG_ERR_HEIGHT,          /* invalid pbm height */
+  PRIMG_ERR_TOO_LARGE,       /* image too large */
+  PRIMG_ERR_NOT_IMPLEMENTED, /* format not supported yet */
+  PRIMG_ERR_NOMEM,           /* out of memory */
+  PRIMG_ERR_CANCELLED,       /* operation cancelled by the caller */
+  PRIMG_ERR_BUFFER,          /* output buffer too small */
+  PRIMG_ERR_INVALID,         /* invalid argument */
+  PRIMG_ERR_NO_PRIME,        /* no prime fits in the image */
+  PRIMG_ERR_PROFILE,         /* invalid tuning profile */
+  PRIMG_ERR_NO_PROFILE       /* no tuning profile for this CPU */
+};
+
+/* Non fatal problems found while loading an image. */
+enum primg_warning {
+  PRIMG_WARN_GARBAGE    = 0x1, /* garbage after raster data */
+  PRIMG_WARN_INCOMPLETE = 0x2  /* incomplete raster data */
+};
+
+/* Order in which pixels are mapped to bits, the first pixel of the
+   order being the most significant bit of the integer. */
+enum primg_order {
+  PRIMG_ORDER_ROW,        /* row-major from the top-left pixel */
+  PRIMG_ORDER_COLUMN,     /* column-major (transposed) */
+  PRIMG_ORDER_SERPENTINE, /* row-major, every other row right to left */
+  PRIMG_ORDER_BOTTOM_UP,  /* row-major from the bottom-left pixel */
+  PRIMG_ORDER_MAX
+};
+
+#define PRIMG_ORDER_ALL ((1 << PRIMG_ORDER_MAX) - 1)
+
+/* How to select the result when racing multiple orders. */
+enum primg_select {
+  PRIMG_SELECT_FIRST, /* first prime found */
+  PRIMG_SELECT_BEST   /* prime with the fewest modified pixels */
+};
+
+struct primg_profile;
+
+struct primg_options {
+  int reps;            /* Miller-Rabin rounds for each probable prime test */
+  unsigned int orders; /* mask of (1 << primg_order), one thread per order */
+  int select;          /* primg_select */
+
+  /* Candidates are sieved by odd primes up to sieve_bound, window odd
+     candidates at a time, before the probable prime test. A zero bound
+     disables the sieve. The bound is at most 4194304 and the window at
+     most 65536. When a profile is given, both are chosen from the
+     profile according to the size of the image integer. */
+  unsigned int sieve_bound;
+  unsigned int window;
+  const struct primg_profile *profile;
+};
+
+/* Cancellation token. It may be shared between the thread running
+   primg_primify() and any other thread. Only use the functions below
+   to access it. */
+struct primg_cancel {
+  int cancelled;
+};
+
+struct pbm_img;
+
+const char * primg_strerror(int error);
+
+void primg_options_init(struct primg_options *opts);
+
+void primg_cancel_init(struct primg_cancel *cancel);
+void primg_cancel(struct primg_cancel *cancel);
+int  primg_is_cancelled(const struct primg_cancel *cancel);
+
+/* Load a PBM image from a file descriptor or a memory buffer. On success
+   a new handle is stored in *img. The file descriptor is not closed. */
+int primg_load_fd(struct pbm_img **img, int fd);
+int primg_load_mem(struct pbm_img **img, const void *buf, size_t size);
+void primg_free(struct pbm_img *img);
+
+unsigned int primg_width(const struct pbm_img *img);
+unsigned int primg_height(const struct pbm_img *img);
+unsigned int primg_warnings(const struct pbm_img *img);
+int primg_order(const struct pbm_img *img);
+
+/* Name of an order and the reverse. primg_order_parse() returns -1 for
+   an unknown name. */
+const char * primg_order_name(int order);
+int primg_order_parse(const char *name);
+
+/* Replace the image with the nearest upper probable prime. Both opts and
+   cancel may be NULL for default options and no cancellation. When more
+   than one order is selected they are searched in parallel and the order
+   retained is available with primg_order(). With an order other than row
+   the image is prime when read in that order. */
+int primg_primify(struct pbm_img *img,
+                  const struct primg_options *opts,
+                  const struct primg_cancel *cancel);
+
+/* Benchmark the sieve against the probable prime test on this machine and
+   save the best parameters for a range of integer sizes in the profile file.
+   Profiles for other CPU models in the same file are kept. */
+int primg_tune(const char *path,
+               const struct primg_options *opts,
+               const struct primg_cancel *cancel);
+
+/* Load the tuning profile of this CPU model from the profile file. A loaded
+   profile is read-only and may be shared between threads. A profile file
+   may be shared by different CPU models, so on PRIMG_ERR_NO_PROFILE callers
+   are expected to keep the default sieve_bound and window. */
+int primg_profile_load(struct primg_profile **profile, const char *path);
+void primg_profile_free(struct primg_profile *profile);
+
+/* Export the image as PBM ASCII. primg_output_size() gives the exact
+   number of bytes primg_output_mem() will write. */
+size_t primg_output_size(const struct pbm_img *img);
+int primg_output_mem(const struct pbm_img *img, void *buf, size_t size, size_t *written);
+int primg_output_fd(const struct pbm_img *img, int fd);
+
+#endif /* _PRIMG_H_ */
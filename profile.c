@@ -0,0 +1,445 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef __linux__
+# define _POSIX_C_SOURCE 200809L /* fdopen(), fchmod() */
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/stat.h>
+
+#if defined(__FreeBSD__) || defined(__DragonFly__) || defined(__APPLE__)
+# include <sys/types.h>
+# include <sys/sysctl.h>
+#endif
+
+#include "profile.h"
+#include "sieve.h"
+#include "primg.h"
+
+#define MAX_LINE_SIZE   256
+#define MAX_TEMP_SUFFIX 32  /* ".<pid>.<try>" */
+#define MAX_TEMP_TRIES  100
+
+static void strip(char *s)
+{
+  size_t n = strlen(s);
+
+  while(n && (s[n - 1] == '\n' || s[n - 1] == ' ' || s[n - 1] == '\t'))
+    s[--n] = '\0';
+}
+
+void cpu_model(char *buf, size_t size)
+{
+#if defined(__FreeBSD__) || defined(__DragonFly__) || defined(__APPLE__)
+  size_t len = size;
+
+  if(sysctlbyname("hw.model", buf, &len, NULL, 0) == 0) {
+    buf[size - 1] = '\0';
+    strip(buf);
+    return;
+  }
+#else
+  /* Many ARM kernels have no model name, fall back
+     on the SoC name then on the implementer/part IDs. */
+  char line[MAX_LINE_SIZE];
+  char hardware[MAX_CPU_MODEL] = "", implementer[32] = "", part[32] = "";
+  FILE *fp = fopen("/proc/cpuinfo", "r");
+
+  if(fp) {
+    while(fgets(line, sizeof(line), fp)) {
+      char *s = strchr(line, ':');
+
+      if(!s)
+        continue;
+
+      for(s++ ; *s == ' ' ; s++);
+      strip(s);
+
+      if(!strncmp(line, "model name", 10)) {
+        snprintf(buf, size, "%s", s);
+        fclose(fp);
+        return;
+      }
+      else if(!strncmp(line, "Hardware", 8) && !hardware[0])
+        snprintf(hardware, sizeof(hardware), "%s", s);
+      else if(!strncmp(line, "CPU implementer", 15) && !implementer[0])
+        snprintf(implementer, sizeof(implementer), "%s", s);
+      else if(!strncmp(line, "CPU part", 8) && !part[0])
+        snprintf(part, sizeof(part), "%s", s);
+    }
+    fclose(fp);
+
+    if(hardware[0]) {
+      snprintf(buf, size, "%s", hardware);
+      return;
+    }
+    else if(implementer[0] && part[0]) {
+      snprintf(buf, size, "implementer %s part %s", implementer, part);
+      return;
+    }
+  }
+#endif
+
+  snprintf(buf, size, "unknown");
+}
+
+static int add_entry(struct primg_profile *profile, const struct profile_entry *entry)
+{
+  unsigned int i;
+
+  if(profile->n == MAX_PROFILE_ENTRIES)
+    return PRIMG_ERR_PROFILE;
+
+  /* keep them sorted */
+  for(i = profile->n ; i && profile->entries[i - 1].bits > entry->bits ; i--)
+    profile->entries[i] = profile->entries[i - 1];
+  profile->entries[i] = *entry;
+  profile->n++;
+
+  return PRIMG_OK;
+}
+
+/* Parse all the profiles in the file. A file without version or with a newer
+   version is always an error. When lenient, as when we rewrite the file, a
+   malformed section is dropped and a file with an older version yields no
+   profile, instead of failing. */
+static int parse(FILE *fp, struct primg_profile **profiles, unsigned int *n,
+                 int lenient)
+{
+  char line[MAX_LINE_SIZE];
+  struct primg_profile *current = NULL;
+  unsigned int version = 0;
+  int bad = 0; /* current section malformed */
+  int ret;
+
+  *profiles = NULL;
+  *n        = 0;
+
+  while(fgets(line, sizeof(line), fp)) {
+    struct profile_entry entry;
+    int too_long = !strchr(line, '\n') && !feof(fp);
+
+    if(too_long) {
+      int c;
+      while((c = fgetc(fp)) != EOF && c != '\n');
+    }
+
+    strip(line);
+    if(!too_long && (line[0] == '#' || line[0] == '\0'))
+      continue;
+
+    if(!version) {
+      if(too_long || sscanf(line, "version %u", &version) != 1 ||
+         version == 0 || version > PROFILE_VERSION)
+        goto ERR;
+      if(version < PROFILE_VERSION) {
+        if(lenient)
+          return PRIMG_OK;
+        goto ERR;
+      }
+    }
+    else if(!strncmp(line, "cpu ", 4)) {
+      struct primg_profile *p;
+
+      if(too_long && !lenient)
+        goto ERR;
+      if(bad)
+        (*n)--;
+
+      p = realloc(*profiles, (*n + 1) * sizeof(struct primg_profile));
+      if(!p) {
+        ret = PRIMG_ERR_NOMEM;
+        goto ERR_RET;
+      }
+
+      *profiles = p;
+      current   = &p[(*n)++];
+      current->n = 0;
+      snprintf(current->cpu, MAX_CPU_MODEL, "%.*s", MAX_CPU_MODEL - 1, line + 4);
+      bad = too_long;
+    }
+    else {
+      if(too_long || !current ||
+         sscanf(line, "%lu %u %u", &entry.bits, &entry.bound, &entry.window) != 3 ||
+         (entry.bound && entry.bound < 3) || entry.bound > SIEVE_MAX_BOUND ||
+         entry.window == 0 || entry.window > SIEVE_MAX_WINDOW ||
+         add_entry(current, &entry) != PRIMG_OK) {
+        if(!lenient)
+          goto ERR;
+        bad = current != NULL;
+      }
+    }
+  }
+
+  if(ferror(fp)) {
+    ret = PRIMG_ERR_IO;
+    goto ERR_RET;
+  }
+
+  if(bad)
+    (*n)--;
+
+  return PRIMG_OK;
+
+ERR:
+  ret = PRIMG_ERR_PROFILE;
+ERR_RET:
+  free(*profiles);
+  *profiles = NULL;
+  *n        = 0;
+  return ret;
+}
+
+int primg_profile_load(struct primg_profile **profile, const char *path)
+{
+  struct primg_profile *profiles;
+  char cpu[MAX_CPU_MODEL];
+  unsigned int i, n;
+  int ret;
+  FILE *fp;
+
+  if(!profile || !path)
+    return PRIMG_ERR_INVALID;
+
+  fp = fopen(path, "r");
+  if(!fp)
+    return PRIMG_ERR_IO;
+
+  ret = parse(fp, &profiles, &n, 0);
+  fclose(fp);
+  if(ret != PRIMG_OK)
+    return ret;
+
+  cpu_model(cpu, sizeof(cpu));
+
+  for(i = 0 ; i < n ; i++)
+    if(!strcmp(profiles[i].cpu, cpu) && profiles[i].n)
+      break;
+
+  if(i == n) {
+    free(profiles);
+    return PRIMG_ERR_NO_PROFILE;
+  }
+
+  *profile = malloc(sizeof(struct primg_profile));
+  if(!*profile) {
+    free(profiles);
+    return PRIMG_ERR_NOMEM;
+  }
+
+  **profile = profiles[i];
+  free(profiles);
+
+  return PRIMG_OK;
+}
+
+void primg_profile_free(struct primg_profile *profile)
+{
+  free(profile);
+}
+
+static unsigned int lerp(unsigned int a, unsigned int b, uint64_t num, uint64_t den)
+{
+  return (a * (den - num) + b * num) / den;
+}
+
+void profile_params(const struct primg_profile *profile, unsigned long bits,
+                    unsigned int *bound, unsigned int *window)
+{
+  const struct profile_entry *lo, *hi;
+  unsigned int i;
+
+  for(i = 1 ; i < profile->n && profile->entries[i].bits < bits ; i++);
+
+  hi = &profile->entries[i < profile->n ? i : profile->n - 1];
+  lo = &profile->entries[i - 1];
+
+  if(bits <= lo->bits || lo == hi) {
+    *bound  = lo->bound;
+    *window = lo->window;
+  }
+  else if(bits >= hi->bits) {
+    *bound  = hi->bound;
+    *window = hi->window;
+  }
+  else if(!lo->bound || !hi->bound) {
+    /* no sieve on one side, take the nearest entry */
+    const struct profile_entry *e = bits - lo->bits < hi->bits - bits ? lo : hi;
+
+    *bound  = e->bound;
+    *window = e->window;
+  }
+  else {
+    uint64_t num = bits - lo->bits, den = hi->bits - lo->bits;
+
+    *bound  = lerp(lo->bound, hi->bound, num, den);
+    *window = lerp(lo->window, hi->window, num, den);
+  }
+}
+
+static void write_profile(FILE *fp, const struct primg_profile *profile)
+{
+  unsigned int i;
+
+  fprintf(fp, "cpu %s\n", profile->cpu);
+  for(i = 0 ; i < profile->n ; i++)
+    fprintf(fp, "%lu %u %u\n", profile->entries[i].bits,
+            profile->entries[i].bound, profile->entries[i].window);
+}
+
+/* Read the profiles of the other CPU models. We refuse to rewrite a file we
+   do not understand, one from an older version is simply replaced. */
+static int read_others(const char *path, struct primg_profile **profiles, unsigned int *n)
+{
+  FILE *fp;
+  int ret;
+
+  *profiles = NULL;
+  *n        = 0;
+
+  fp = fopen(path, "r");
+  if(!fp)
+    return errno == ENOENT ? PRIMG_OK : PRIMG_ERR_IO;
+
+  ret = parse(fp, profiles, n, 1);
+  fclose(fp);
+
+  return ret;
+}
+
+/* Create a temporary file next to the profile so that we can rename it
+   into place once it is complete. It gets the mode of the existing profile
+   or, for a new one, the usual mode for the umask of the caller. */
+static FILE * open_temp(const char *path, char **tmp)
+{
+  struct stat st;
+  unsigned int i;
+  FILE *fp;
+  int fd = -1;
+
+  *tmp = malloc(strlen(path) + MAX_TEMP_SUFFIX);
+  if(!*tmp)
+    return NULL;
+
+  for(i = 0 ; i < MAX_TEMP_TRIES && fd < 0 ; i++) {
+    sprintf(*tmp, "%s.%ld.%u", path, (long)getpid(), i);
+    fd = open(*tmp, O_WRONLY | O_CREAT | O_EXCL, 0666);
+    if(fd < 0 && errno != EEXIST)
+      break;
+  }
+  if(fd < 0)
+    goto ERR;
+
+  if(stat(path, &st) == 0)
+    fchmod(fd, st.st_mode & 07777);
+
+  fp = fdopen(fd, "w");
+  if(!fp) {
+    close(fd);
+    unlink(*tmp);
+    goto ERR;
+  }
+
+  return fp;
+
+ERR:
+  free(*tmp);
+  *tmp = NULL;
+  return NULL;
+}
+
+int profile_check(const char *path)
+{
+  struct primg_profile *profiles;
+  unsigned int n;
+  char *tmp;
+  FILE *fp;
+  int ret;
+
+  ret = read_others(path, &profiles, &n);
+  free(profiles);
+  if(ret != PRIMG_OK)
+    return ret;
+
+  fp = open_temp(path, &tmp);
+  if(!fp)
+    return PRIMG_ERR_IO;
+
+  fclose(fp);
+  unlink(tmp);
+  free(tmp);
+
+  return PRIMG_OK;
+}
+
+int profile_save(const char *path, const struct primg_profile *profile)
+{
+  struct primg_profile *profiles;
+  unsigned int i, n;
+  char *tmp;
+  int ret;
+  FILE *fp;
+
+  ret = read_others(path, &profiles, &n);
+  if(ret != PRIMG_OK)
+    return ret;
+
+  fp = open_temp(path, &tmp);
+  if(!fp) {
+    free(profiles);
+    return PRIMG_ERR_IO;
+  }
+
+  fprintf(fp, "# primg tuning profile\n");
+  fprintf(fp, "# bits sieve-bound sieve-window\n");
+  fprintf(fp, "version %u\n", PROFILE_VERSION);
+
+  for(i = 0 ; i < n ; i++)
+    if(strcmp(profiles[i].cpu, profile->cpu))
+      write_profile(fp, &profiles[i]);
+  write_profile(fp, profile);
+
+  free(profiles);
+
+  ret = PRIMG_OK;
+  if(ferror(fp))
+    ret = PRIMG_ERR_IO;
+  if(fclose(fp))
+    ret = PRIMG_ERR_IO;
+  if(ret == PRIMG_OK && rename(tmp, path))
+    ret = PRIMG_ERR_IO;
+
+  if(ret != PRIMG_OK)
+    unlink(tmp);
+  free(tmp);
+
+  return ret;
+}
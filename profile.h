@@ -0,0 +1,61 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+#include "primg.h"
+
+#define PROFILE_VERSION     1
+#define MAX_PROFILE_ENTRIES 64
+#define MAX_CPU_MODEL       128
+
+struct profile_entry {
+  unsigned long bits;   /* size of the integer */
+  unsigned int  bound;  /* sieve bound */
+  unsigned int  window; /* sieve window */
+};
+
+/* Tuning for one CPU model, entries sorted by bits. */
+struct primg_profile {
+  char cpu[MAX_CPU_MODEL];
+
+  unsigned int n;
+  struct profile_entry entries[MAX_PROFILE_ENTRIES];
+};
+
+void cpu_model(char *buf, size_t size);
+
+/* Sieve parameters interpolated for an integer of the given size. */
+void profile_params(const struct primg_profile *profile, unsigned long bits,
+                    unsigned int *bound, unsigned int *window);
+
+/* Check that the profile file can be updated. */
+int profile_check(const char *path);
+
+/* Write the profile in the file, replacing the one
+   with the same CPU model and keeping the others. */
+int profile_save(const char *path, const struct primg_profile *profile);
+
+#endif /* _PROFILE_H_ */
@@ -0,0 +1,118 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <gmp.h>
+
+#include "sieve.h"
+#include "primg.h"
+
+int sieve_init(struct sieve *sieve, unsigned int bound, unsigned int window)
+{
+  unsigned char *composite;
+  unsigned int i, j, n = 0;
+
+  memset(sieve, 0, sizeof(struct sieve));
+
+  if(bound < 3 || bound > SIEVE_MAX_BOUND ||
+     window == 0 || window > SIEVE_MAX_WINDOW)
+    return PRIMG_ERR_INVALID;
+
+  /* odd numbers only, index i for 2i + 1 */
+  composite = calloc(bound / 2 + 1, 1);
+  if(!composite)
+    return PRIMG_ERR_NOMEM;
+
+  for(i = 1 ; (uint64_t)(2 * i + 1) * (2 * i + 1) <= bound ; i++)
+    if(!composite[i])
+      for(j = (2 * i + 1) * (2 * i + 1) / 2 ; j <= bound / 2 ; j += 2 * i + 1)
+        composite[j] = 1;
+
+  for(i = 1 ; i <= (bound - 1) / 2 ; i++)
+    n += !composite[i];
+
+  sieve->primes = malloc(n * sizeof(unsigned int));
+  sieve->marks  = malloc(window);
+  if(!sieve->primes || !sieve->marks) {
+    free(composite);
+    sieve_free(sieve);
+    return PRIMG_ERR_NOMEM;
+  }
+
+  for(i = 1, n = 0 ; i <= (bound - 1) / 2 ; i++)
+    if(!composite[i])
+      sieve->primes[n++] = 2 * i + 1;
+  free(composite);
+
+  sieve->nprimes = n;
+  sieve->bound   = bound;
+  sieve->window  = window;
+
+  return PRIMG_OK;
+}
+
+void sieve_free(struct sieve *sieve)
+{
+  free(sieve->primes);
+  free(sieve->marks);
+  memset(sieve, 0, sizeof(struct sieve));
+}
+
+unsigned int sieve_window(struct sieve *sieve, const mpz_t base, unsigned int window)
+{
+  unsigned int i, k, end, survivors = 0;
+
+  memset(sieve->marks, 0, window);
+
+  for(k = 0 ; k < sieve->nprimes ; k = end) {
+    unsigned long product = 1, r;
+
+    /* One pass over the large integer for as
+       many primes as their product fits in a limb. */
+    for(end = k ; end < sieve->nprimes &&
+          product <= ULONG_MAX / sieve->primes[end] ; end++)
+      product *= sieve->primes[end];
+    r = mpz_fdiv_ui(base, product);
+
+    for(; k < end ; k++) {
+      unsigned int p  = sieve->primes[k];
+      unsigned int rp = r % p;
+
+      /* first i such that base + 2i = 0 (mod p),
+         that is i = -r / 2 with 1/2 = (p + 1) / 2 */
+      i = (uint64_t)(p - rp) % p * ((p + 1) / 2) % p;
+
+      for(; i < window ; i += p)
+        sieve->marks[i] = 1;
+    }
+  }
+
+  for(i = 0 ; i < window ; i++)
+    survivors += !sieve->marks[i];
+
+  return survivors;
+}
@@ -22,11 +22,30 @@
    SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
  */
 
-#ifndef _PRIME_H_
-#define _PRIME_H_
+#ifndef _SIEVE_H_
+#define _SIEVE_H_
 
-#include "load.h"
+#include <gmp.h>
 
-void primify(struct pbm_img *img);
+/* Largest parameters accepted, also the largest ones tuned. */
+#define SIEVE_MAX_BOUND  4194304
+#define SIEVE_MAX_WINDOW 65536
 
-#endif /* _PRIME_H_ */
+/* Sieve of Eratosthenes over a window of odd candidates. */
+struct sieve {
+  unsigned int  *primes;  /* odd primes up to the bound */
+  unsigned int   nprimes;
+  unsigned int   bound;
+  unsigned int   window;  /* number of odd candidates */
+  unsigned char *marks;   /* non zero for composite candidates */
+};
+
+int sieve_init(struct sieve *sieve, unsigned int bound, unsigned int window);
+void sieve_free(struct sieve *sieve);
+
+/* Mark the candidates base + 2i for i < window which have a factor up to the
+   bound. The base must be odd and larger than the bound. Return the number of
+   remaining candidates. */
+unsigned int sieve_window(struct sieve *sieve, const mpz_t base, unsigned int window);
+
+#endif /* _SIEVE_H_ */
@@ -0,0 +1,239 @@
+/* Copyright (c) 2018, David Hauweele <david@hauweele.net>
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+    1. Redistributions of source code must retain the above copyright notice, this
+       list of conditions and the following disclaimer.
+    2. Redistributions in binary form must reproduce the above copyright notice,
+       this list of conditions and the following disclaimer in the documentation
+       and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef __linux__
+# define _POSIX_C_SOURCE 200809L /* clock_gettime() */
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <gmp.h>
+
+#include "common.h"
+#include "profile.h"
+#include "sieve.h"
+#include "primg.h"
+
+#define TUNE_MIN_BITS  64
+#define TUNE_MAX_BITS  16384
+#define TUNE_MIN_TIME  0.02 /* seconds per measurement run */
+#define TUNE_RUNS      3    /* keep the fastest run */
+#define TUNE_MARGIN    0.05 /* a larger setting must be that much faster */
+#define TUNE_SEED      947
+
+/* A zero bound is the search without sieve. */
+static const unsigned int bounds[]  = { 0, 256, 1024, 4096, 16384, 65536,
+                                        262144, 1048576, SIEVE_MAX_BOUND };
+static const unsigned int windows[] = { 64, 256, 1024, 4096, 16384,
+                                        SIEVE_MAX_WINDOW };
+
+static double now(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+/* Cost of the probable prime tests on the span for the candidates which
+   survive the sieve (if any) but not the reference sieve. The others are
+   tested whatever the sieve bound so they do not change the outcome. */
+static double prp_cost(struct sieve *sieve, const struct sieve *ref,
+                       const mpz_t base, unsigned int span, int reps)
+{
+  double best = 0;
+  unsigned int i, run;
+  mpz_t candidate;
+
+  mpz_init(candidate);
+
+  if(sieve)
+    sieve_window(sieve, base, span);
+
+  for(run = 0 ; run < TUNE_RUNS ; run++) {
+    double begin = now(), elapsed;
+    unsigned int passes = 0;
+
+    do {
+      for(i = 0 ; i < span ; i++) {
+        if((sieve && sieve->marks[i]) || !ref->marks[i])
+          continue;
+
+        mpz_add_ui(candidate, base, 2 * (unsigned long)i);
+        mpz_probab_prime_p(candidate, reps);
+      }
+      passes++;
+    } while((elapsed = now() - begin) < TUNE_MIN_TIME);
+
+    if(run == 0 || elapsed / passes < best)
+      best = elapsed / passes;
+  }
+
+  mpz_clear(candidate);
+
+  return best;
+}
+
+/* Cost of sieving a window. */
+static double sieve_cost(struct sieve *sieve, const mpz_t base, unsigned int window)
+{
+  double best = 0;
+  unsigned int run;
+
+  for(run = 0 ; run < TUNE_RUNS ; run++) {
+    double begin = now(), elapsed;
+    unsigned int passes = 0;
+
+    do {
+      sieve_window(sieve, base, window);
+      passes++;
+    } while((elapsed = now() - begin) < TUNE_MIN_TIME);
+
+    if(run == 0 || elapsed / passes < best)
+      best = elapsed / passes;
+  }
+
+  return best;
+}
+
+/* Find the sieve parameters which minimize the time spent to go through
+   the expected gap to the next prime, that is ln(2^bits) / 2 odd
+   candidates. Settings are tried from the cheapest to the most expensive
+   and a later one is only kept when it is clearly faster, so that noise
+   does not flip the profile between two runs. */
+static int tune_bits(struct profile_entry *entry, unsigned long bits,
+                     gmp_randstate_t state, int reps,
+                     const struct primg_cancel *cancel)
+{
+  unsigned int span = bits * 0.6931 / 2 + 1;
+  double best_cost;
+  struct sieve ref;
+  unsigned int i, j;
+  mpz_t base;
+  int ret;
+
+  if(span > SIEVE_MAX_WINDOW)
+    span = SIEVE_MAX_WINDOW;
+
+  mpz_init(base);
+  mpz_urandomb(base, state, bits);
+  mpz_setbit(base, bits - 1);
+  mpz_setbit(base, 0);
+
+  ret = sieve_init(&ref, SIEVE_MAX_BOUND, span);
+  if(ret != PRIMG_OK)
+    goto EXIT;
+  sieve_window(&ref, base, span);
+
+  /* without sieve the window is not used */
+  for(j = 0 ; j < sizeof_array(windows) - 1 && windows[j] < span ; j++);
+  entry->bits   = bits;
+  entry->bound  = 0;
+  entry->window = windows[j];
+  best_cost     = prp_cost(NULL, &ref, base, span, reps);
+
+  for(i = 1 ; i < sizeof_array(bounds) ; i++) {
+    struct sieve sieve;
+    double t_prp;
+
+    if(cancel && primg_is_cancelled(cancel)) {
+      ret = PRIMG_ERR_CANCELLED;
+      break;
+    }
+
+    ret = sieve_init(&sieve, bounds[i], SIEVE_MAX_WINDOW);
+    if(ret != PRIMG_OK)
+      break;
+
+    t_prp = prp_cost(&sieve, &ref, base, span, reps);
+
+    for(j = 0 ; j < sizeof_array(windows) ; j++) {
+      unsigned int nb_windows = (span + windows[j] - 1) / windows[j];
+      double cost;
+
+      /* past the span a larger window only costs more */
+      if(j && windows[j - 1] >= span)
+        break;
+
+      cost = nb_windows * sieve_cost(&sieve, base, windows[j]) + t_prp;
+      if(cost < best_cost * (1 - TUNE_MARGIN)) {
+        best_cost     = cost;
+        entry->bound  = bounds[i];
+        entry->window = windows[j];
+      }
+    }
+
+    sieve_free(&sieve);
+  }
+
+  sieve_free(&ref);
+EXIT:
+  mpz_clear(base);
+  return ret;
+}
+
+int primg_tune(const char *path,
+               const struct primg_options *opts,
+               const struct primg_cancel *cancel)
+{
+  struct primg_options defaults;
+  struct primg_profile profile;
+  gmp_randstate_t state;
+  unsigned long bits;
+  int ret = PRIMG_OK;
+
+  if(!path)
+    return PRIMG_ERR_INVALID;
+
+  if(!opts) {
+    primg_options_init(&defaults);
+    opts = &defaults;
+  }
+
+  /* fail early rather than after the benchmark */
+  ret = profile_check(path);
+  if(ret != PRIMG_OK)
+    return ret;
+
+  memset(&profile, 0, sizeof(profile));
+  cpu_model(profile.cpu, MAX_CPU_MODEL);
+
+  /* Always the same integers so that profiles are comparable. */
+  gmp_randinit_default(state);
+  gmp_randseed_ui(state, TUNE_SEED);
+
+  for(bits = TUNE_MIN_BITS ; bits <= TUNE_MAX_BITS ; bits *= 2) {
+    ret = tune_bits(&profile.entries[profile.n], bits, state, opts->reps, cancel);
+    if(ret != PRIMG_OK)
+      goto EXIT;
+    profile.n++;
+  }
+
+  ret = profile_save(path, &profile);
+
+EXIT:
+  gmp_randclear(state);
+  return ret;
+}